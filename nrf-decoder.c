@@ -8,6 +8,13 @@
 #include <getopt.h>
 #include <ctype.h>
 #include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
 
 /*
 nrf-decoder version 1 (c) 2022 by kittennbfive
@@ -60,6 +67,20 @@ typedef enum
 	FILTER_BY_ADDRESS //--filter-addr $addr_in_hex
 } filtermode_t;
 
+typedef enum //--sample-format [bit|bit-mag|float]
+{
+	SAMPLE_BIT, //default, one byte per sample, bit 0 is the sliced bit
+	SAMPLE_BIT_MAG, //same but bits 7..1 are the quantized signal magnitude, see nrf-receiver.grc
+	SAMPLE_FLOAT //float32 output of the FM demodulator, bits are decided by integrate-and-dump
+} sampleformat_t;
+
+typedef enum
+{
+	INDEX_OFF, //default
+	INDEX_WRITE, //--index-write $file
+	INDEX_QUERY //--index-query $file
+} indexmode_t;
+
 static nrfmode_t nrfmode=MODE_NORMAL;
 static payloadlengthmode_t payloadlengthmode=PAYLOAD_FIXED_LENGTH;
 static crcmode_t crcmode=CRC_ONE_BYTE;
@@ -67,16 +88,26 @@ static crcmode_t crcmode=CRC_ONE_BYTE;
 static dispmode_t dispmode=DISP_SUMMARY;
 static dumpmode_t dumpmode=DUMP_OFF;
 static filtermode_t filtermode=FILTER_PROMISCUOUS_MODE;
+static indexmode_t indexmode=INDEX_OFF;
+static sampleformat_t sampleformat=SAMPLE_BIT;
 
 static uint8_t samples_per_bit=0; //--spb $samples_per_bit MANDATORY
 
 static uint8_t sz_addr_bytes=0; //--sz-addr $sz MANDATORY
 static uint8_t filter_by_address[5]; //max 5 bytes by specification, usage see filtermode_t
+static uint8_t sync_tolerance=2; //--sync-tolerance $bits, number of wrong bits accepted in preamble+address if --filter-addr is used
 
 static uint8_t sz_payload_bytes=0; //--sz-payload $sz, must be >=1
 static uint8_t sz_ack_payload_bytes=0; //--sz-ack-payload $sz, can be 0!
 static bool sz_ack_payload_bytes_specified=false;
 
+static int32_t dedup_window_ms=100; //--dedup-window $ms, only used with several --input
+
+static char const * index_filename=NULL; //--index-write|--index-query $file
+static uint32_t samplerate=0; //--samplerate $sps, mandatory for --index-write and several --input
+static double query_from=0; //--from $seconds
+static double query_to=-1; //--to $seconds, <0 means end of capture
+
 //do not change - hardcoded by specification
 #define SZ_ADDR_BYTES_MAX 5
 #define NB_DATA_BYTES_MAX 32
@@ -85,9 +116,27 @@ static bool sz_ack_payload_bytes_specified=false;
 #define CRC8_POLY 0x07
 #define CRC16_POLY 0x1021
 #define BUF_CRC_MAX (SZ_ADDR_BYTES_MAX+NB_DATA_BYTES_MAX+2) //2 bytes for PCF
-#define MAX_PACKET_LENGTH_SAMPLES (8*(1+SZ_ADDR_BYTES_MAX+2+NB_DATA_BYTES_MAX+2)*samples_per_bit) //1 for preamble, 2 for PCF, 2 for CRC
+#define MAX_PACKET_LENGTH_BITS (8*(1+SZ_ADDR_BYTES_MAX+2+NB_DATA_BYTES_MAX+2)) //1 for preamble, 2 for PCF, 2 for CRC
+#define MAX_PACKET_LENGTH_SAMPLES (MAX_PACKET_LENGTH_BITS*samples_per_bit)
 
 #define SZ_BUFFER_SAMPLES (4*MAX_PACKET_LENGTH_SAMPLES) //4 randomly choosen, seems to work fine
+#define SEARCH_WINDOW_SAMPLES ((sampleformat==SAMPLE_FLOAT)?MAX_PACKET_LENGTH_SAMPLES+samples_per_bit:MAX_PACKET_LENGTH_SAMPLES) //float needs one more bit for decode_packet_float()
+
+#define NB_INPUTS_MAX 16 //must fit into the receivers-bitmask of pending_packet_t
+#define SZ_READ_CHUNK 4096
+#define SZ_PENDING_QUEUE 64
+
+#define SYNC_WORD_BITS_MAX (BITS_PREAMBLE+8*SZ_ADDR_BYTES_MAX)
+_Static_assert(SYNC_WORD_BITS_MAX<=64, "sync word must fit in uint64_t, see sync_shiftregs");
+
+#define MAG_FULL_SCALE 127 //7 bits, must match nrf-receiver.grc
+#define NOISE_FLOOR_SHIFT 12 //time constant of the noise floor average is 2^12 samples
+#define NOISE_FLOOR_GATE 3 //samples with a magnitude above 3 times the noise floor (~10dB) are signal, for instance a packet of another address with --filter-addr
+#define TIME_BASE_DRIFT_US 1 //per read(), see update_time_base()
+#define SAMPLE_CLOCK_DRIFT_PPM 50 //between two receivers, see is_copy()
+#define RECEIVER_OFFSET_MISSES_MAX 3 //a receiver restarted or the offset was learned from a retransmission, see is_copy()
+
+#define NB_ADDR_STATS_MAX 64
 
 //internal stuff
 typedef enum
@@ -123,73 +172,250 @@ typedef struct
 	} crc;
 } nRF24_packet_t;
 
-#define BITS_TO_SAMPLES(nb) (nb*samples_per_bit)
+#define BITS_TO_SAMPLES(nb) ((nb)*samples_per_bit)
 #define BYTES_TO_SAMPLES(nb) (8*BITS_TO_SAMPLES(nb))
 
-static uint8_t * ringbuffer;
-static uint32_t nb_samples=0;
-static uint32_t write_index=0;
-static uint32_t read_index=0;
+//one of these for each input (receiver), every input is decoded independently
+typedef struct
+{
+	char const * name;
+	uint8_t index;
+	int fd;
+	uint8_t * ringbuffer;
+	float * ringbuffer_float; //instead of ringbuffer for --sample-format float, the first samples_per_bit samples are repeated at the end
+	float * ringbuffer_integrated; //average of the samples_per_bit samples starting at each position of ringbuffer_float
+	uint8_t chunk[SZ_READ_CHUNK]; //read by read_stream(), decoded by decode_chunk()
+	uint16_t sz_chunk;
+	uint8_t partial_sample[sizeof(float)]; //incomplete float from the last read()
+	uint8_t nb_partial_bytes;
+	uint32_t nb_samples;
+	uint32_t write_index;
+	uint32_t read_index;
+	uint64_t sample_offset; //position of ring buffer position 0 inside the whole input
+	int64_t time_base_us; //wall clock of sample 0, 0 if unknown, see update_time_base()
+	bool eof; //not waited for anymore by flush_pending_packets()
+	uint64_t * sync_shiftregs; //last bits seen at each sample phase, samples_per_bit of them, only for --filter-addr, not with --sample-format float
+	uint64_t sync_next_offset; //next sample to be shifted into sync_shiftregs
+	uint32_t noise_acc; //running average of the magnitude outside of packets, fixed point with NOISE_FLOOR_SHIFT fractional bits, 0 means not measured yet
+	uint64_t nb_packets; //valid packets and signal quality for this receiver alone, for --sample-format bit-mag
+	double sum_rssi;
+	double sum_snr;
+	uint64_t nb_snr;
+	float dc_offset; //measured on the preamble candidate at ring buffer position 0, for --sample-format float
+	float amplitude;
+	uint64_t index_damaged_until; //no record for a damaged packet starting before this sample offset, see index_add_record()
+	uint64_t aligned_offset; //sample phase chosen by decode_packet_float() for the last preamble, UINT64_MAX if none
+	float * soft_bits; //soft value of each bit of the packet being decoded (preamble is bit 0), >0 means 1, for --sample-format float
+} stream_t;
+
+static stream_t streams[NB_INPUTS_MAX];
+static uint8_t nb_streams=0;
+
+//valid packets wait here for copies from other receivers before being displayed, see output_packet()
+typedef struct
+{
+	nRF24_packet_t packet;
+	packettype_t packettype;
+	uint8_t buf[BUF_CRC_MAX];
+	uint16_t bits_total;
+	struct timeval timestamp;
+	int64_t sample_clock_us; //of first_receiver, see get_sample_clock_us()
+	uint8_t first_receiver;
+	uint16_t receivers; //bitmask of stream_t.index
+	float rssi; //dBFS, best of all receivers, only for --sample-format bit-mag
+	float snr; //dB, NAN if unknown
+	float soft_bits[MAX_PACKET_LENGTH_BITS]; //soft value of each bit after the preamble relative to the amplitude of the preamble, from the receiver with the best weakest_bit, only for --sample-format float
+	uint16_t nb_soft_bits;
+	float weakest_bit; //lowest of soft_bits
+} pending_packet_t;
+
+typedef struct
+{
+	uint8_t addr[SZ_ADDR_BYTES_MAX];
+	uint64_t nb_packets;
+	double sum_rssi;
+	double sum_snr;
+	uint64_t nb_snr;
+	float min_snr;
+} addr_stats_t;
+
+static addr_stats_t addr_stats[NB_ADDR_STATS_MAX];
+static uint8_t nb_addr_stats=0;
+
+//preamble+address if --filter-addr is used, MSB first like on air, see check_for_sync_word()
+static uint64_t sync_word;
+static uint64_t sync_mask;
+static uint8_t sync_bits;
+
+static pending_packet_t pending_packets[SZ_PENDING_QUEUE]; //sorted by timestamp
+static uint8_t pending_first=0;
+static uint8_t nb_pending=0;
+
+//offset between the sample clocks of two receivers, measured on the last packets both of them heard, see is_copy()
+typedef struct
+{
+	int64_t offsets_us[3]; //sample clock of the receiver with the higher index minus the other one, the median is used so one wrong merge does not matter
+	uint32_t nb_offsets;
+	int64_t last_sample_clock_us; //of the receiver with the lower index at the last measurement
+	uint32_t nb_misses; //packets in the window that did not fit the offset since the last one that did, relearns at RECEIVER_OFFSET_MISSES_MAX
+} receiver_offset_t;
+
+static receiver_offset_t receiver_offsets[NB_INPUTS_MAX][NB_INPUTS_MAX]; //only [lower index][higher index] is used
+
+//sidecar index for --index-write and --index-query, a header followed by records sorted by sample offset
+#define INDEX_MAGIC "NRFIDX1"
+#define INDEX_FLAG_CRC_OK (1<<0)
 
-void ringbuffer_put_sample(const uint8_t byte)
+typedef struct __attribute__((packed))
 {
-	if(nb_samples++==SZ_BUFFER_SAMPLES)
-		errx(1, "ring buffer overflow");
-	ringbuffer[write_index++]=byte;
-	write_index%=SZ_BUFFER_SAMPLES;	
+	char magic[8];
+	uint32_t samplerate; //to convert sample offsets into time since start of capture
+	uint8_t samples_per_bit;
+	uint8_t sz_addr_bytes;
+	uint8_t sampleformat; //sampleformat_t
+	uint8_t reserved;
+	uint64_t nb_records;
+} index_header_t;
+
+typedef struct __attribute__((packed))
+{
+	uint64_t sample_offset; //first sample of the preamble, also the timestamp (see index_header_t.samplerate)
+	uint8_t addr[SZ_ADDR_BYTES_MAX];
+	uint8_t packettype; //packettype_t
+	uint8_t sz_payload_bytes;
+	uint8_t flags; //INDEX_FLAG_xxx
+} index_record_t;
+
+static FILE * index_file=NULL;
+static uint64_t nb_index_records=0;
+
+void ringbuffer_put_sample(stream_t * const stream, const uint8_t byte)
+{
+	if(stream->nb_samples++==SZ_BUFFER_SAMPLES)
+		errx(1, "ring buffer overflow (%s)", stream->name);
+	stream->ringbuffer[stream->write_index++]=byte;
+	stream->write_index%=SZ_BUFFER_SAMPLES;	
+}
+
+void ringbuffer_put_sample_float(stream_t * const stream, const float sample)
+{
+	if(stream->nb_samples++==SZ_BUFFER_SAMPLES)
+		errx(1, "ring buffer overflow (%s)", stream->name);
+	stream->ringbuffer_float[stream->write_index]=sample;
+	if(stream->write_index<samples_per_bit) //so the samples of one bit are always contiguous
+		stream->ringbuffer_float[SZ_BUFFER_SAMPLES+stream->write_index]=sample;
+	stream->write_index=(stream->write_index+1)%SZ_BUFFER_SAMPLES;
+	
+	if(stream->nb_samples>=samples_per_bit) //integrate-and-dump once per position, the preamble search needs many bits at every position
+	{
+		const uint32_t startindex=(stream->write_index+SZ_BUFFER_SAMPLES-samples_per_bit)%SZ_BUFFER_SAMPLES;
+		float const * const samples=&stream->ringbuffer_float[startindex];
+		float sum=0;
+		uint8_t i;
+		
+		for(i=0; i<samples_per_bit; i++)
+			sum+=samples[i];
+		stream->ringbuffer_integrated[startindex]=sum/samples_per_bit;
+	}
+}
+
+float ringbuffer_get_integrated_at_pos(stream_t const * const stream, const uint32_t startpos) //average of the bit starting at startpos
+{
+	if(startpos+samples_per_bit>stream->nb_samples)
+		errx(1, "ring buffer out of range (requested position %u but only %u samples in buffer)", startpos+samples_per_bit, stream->nb_samples);
+	
+	return stream->ringbuffer_integrated[(stream->read_index+startpos)%SZ_BUFFER_SAMPLES];
+}
+
+//integrate-and-dump over the bit whose middle is at pos, returns the soft value (>0 means 1)
+float ringbuffer_get_soft_bit_at_pos(stream_t const * const stream, const uint32_t pos)
+{
+	const uint32_t startpos=(pos>=samples_per_bit/2)?pos-samples_per_bit/2:0;
+	
+	return ringbuffer_get_integrated_at_pos(stream, startpos)-stream->dc_offset;
 }
 
-uint8_t ringbuffer_get_sample_at_pos(const uint32_t pos)
+uint8_t ringbuffer_get_sample_at_pos(stream_t const * const stream, const uint32_t pos)
 {
-	if(pos>nb_samples)
-		errx(1, "ring buffer out of range (requested position %u but only %u samples in buffer)", pos, nb_samples);
+	if(pos>stream->nb_samples)
+		errx(1, "ring buffer out of range (requested position %u but only %u samples in buffer)", pos, stream->nb_samples);
 	
-	uint8_t byte=ringbuffer[(read_index+pos)%SZ_BUFFER_SAMPLES];
+	uint8_t byte=stream->ringbuffer[(stream->read_index+pos)%SZ_BUFFER_SAMPLES];
 	return byte;
 }
 
-void ringbuffer_remove_samples(const uint32_t nb)
+uint8_t ringbuffer_get_bit_at_pos(stream_t const * const stream, const uint32_t pos)
+{
+	if(sampleformat==SAMPLE_FLOAT)
+		return ringbuffer_get_soft_bit_at_pos(stream, pos)>0;
+	return ringbuffer_get_sample_at_pos(stream, pos)&1;
+}
+
+uint8_t ringbuffer_get_magnitude_at_pos(stream_t const * const stream, const uint32_t pos)
+{
+	return ringbuffer_get_sample_at_pos(stream, pos)>>1;
+}
+
+void ringbuffer_remove_samples(stream_t * const stream, const uint32_t nb)
 {
-	if(nb>nb_samples)
-		errx(1, "ring buffer underflow (requested removal of %u samples but only %u in buffer)", nb, nb_samples);
+	if(nb>stream->nb_samples)
+		errx(1, "ring buffer underflow (requested removal of %u samples but only %u in buffer)", nb, stream->nb_samples);
 
-	read_index=(read_index+nb)%SZ_BUFFER_SAMPLES;
-	nb_samples-=nb;
+	stream->read_index=(stream->read_index+nb)%SZ_BUFFER_SAMPLES;
+	stream->nb_samples-=nb;
+	stream->sample_offset+=nb;
 }
 
-uint8_t get_bits(const uint32_t startpos_samples, const uint8_t nb_bits)
+void ringbuffer_rewind_samples(stream_t * const stream, const uint32_t nb) //undo ringbuffer_remove_samples(), only valid if no sample was put in between
+{
+	stream->read_index=(stream->read_index+SZ_BUFFER_SAMPLES-nb)%SZ_BUFFER_SAMPLES;
+	stream->nb_samples+=nb;
+	stream->sample_offset-=nb;
+}
+
+uint8_t get_bits(stream_t * const stream, const uint32_t startpos_samples, const uint8_t nb_bits)
 {
 	if(nb_bits>8)
 		errx(1, "get_bits: nb_bits must be <=8");
 	
 	uint8_t byte=0;
 	uint8_t bitnr;
+	uint32_t pos;
+	float soft;
 	
 	for(bitnr=0; bitnr<nb_bits; bitnr++)
 	{
 		byte<<=1;
-		if(ringbuffer_get_sample_at_pos(startpos_samples+BITS_TO_SAMPLES(bitnr)+samples_per_bit/2)) //reading at middle of bit
+		pos=startpos_samples+BITS_TO_SAMPLES(bitnr)+samples_per_bit/2; //reading at middle of bit
+		if(sampleformat==SAMPLE_FLOAT)
+		{
+			soft=ringbuffer_get_soft_bit_at_pos(stream, pos);
+			stream->soft_bits[pos/samples_per_bit]=soft; //copied to pending_packet_t.soft_bits
+			if(soft>0)
+				byte|=1;
+		}
+		else if(ringbuffer_get_bit_at_pos(stream, pos))
 			byte|=1;
 	}
 	
 	return byte;
 }
 
-uint8_t get_byte(const uint32_t startpos_samples)
+uint8_t get_byte(stream_t * const stream, const uint32_t startpos_samples)
 {
-	return get_bits(startpos_samples, 8);
+	return get_bits(stream, startpos_samples, 8);
 }
 
-bool check_for_preamble(void) //preamble can be 0x55 or 0xAA depending on address
+bool check_for_preamble(stream_t const * const stream) //preamble can be 0x55 or 0xAA depending on address
 {
 	uint8_t i;
 	bool bit;
 	
-	if(ringbuffer_get_sample_at_pos(0)==0)
+	if(ringbuffer_get_bit_at_pos(stream, 0)==0)
 	{
 		for(i=0, bit=0; i<8; i++, bit=!bit)
 		{
-			if(ringbuffer_get_sample_at_pos(samples_per_bit/2+i*samples_per_bit)!=bit)
+			if(ringbuffer_get_bit_at_pos(stream, samples_per_bit/2+i*samples_per_bit)!=bit)
 				return false;
 		}
 		return true;
@@ -198,18 +424,58 @@ bool check_for_preamble(void) //preamble can be 0x55 or 0xAA depending on addres
 	{
 		for(i=0, bit=1; i<8; i++, bit=!bit)
 		{
-			if(ringbuffer_get_sample_at_pos(samples_per_bit/2+i*samples_per_bit)!=bit)
+			if(ringbuffer_get_bit_at_pos(stream, samples_per_bit/2+i*samples_per_bit)!=bit)
 				return false;
 		}
 		return true;
 	}
 }
 
-void read_bytes(const uint32_t startpos_samples, const uint8_t nb, uint8_t * const dst)
+void make_sync_word(void)
+{
+	uint8_t i;
+	
+	sync_word=(filter_by_address[0]&0x80)?0xAA:0x55; //preamble depends on first bit of address
+	for(i=0; i<sz_addr_bytes; i++)
+		sync_word=(sync_word<<8)|filter_by_address[i];
+	
+	sync_bits=BITS_PREAMBLE+8*sz_addr_bytes;
+	sync_mask=(sync_bits==64)?UINT64_MAX:((((uint64_t)1)<<sync_bits)-1);
+}
+
+//Used instead of check_for_preamble() when the address is known. Every sample is shifted into the register of its phase (sample offset modulo samples_per_bit), so the register of the phase of the middle of the last bit of the sync word always holds the sync word candidate starting at ring buffer position 0. Comparing is a XOR and a popcount and tolerates some wrong bits.
+bool check_for_sync_word(stream_t * const stream)
+{
+	const uint32_t pos_last_bit=samples_per_bit/2+BITS_TO_SAMPLES(sync_bits-1);
+	uint64_t * reg;
+	uint64_t word=0;
+	uint8_t i;
+	
+	if(sampleformat==SAMPLE_FLOAT) //bits are decided against the DC offset of the preamble candidate at position 0, so they can't be kept for later positions
+	{
+		for(i=0; i<sync_bits; i++)
+			word=(word<<1)|ringbuffer_get_bit_at_pos(stream, samples_per_bit/2+BITS_TO_SAMPLES(i));
+		return __builtin_popcountll((word^sync_word)&sync_mask)<=sync_tolerance;
+	}
+	
+	if(stream->sync_next_offset<stream->sample_offset) //a packet was removed from the ring buffer, old bits are skipped and shifted out below
+		stream->sync_next_offset=stream->sample_offset;
+	
+	while(stream->sync_next_offset<=stream->sample_offset+pos_last_bit)
+	{
+		reg=&stream->sync_shiftregs[stream->sync_next_offset%samples_per_bit];
+		(*reg)=((*reg)<<1)|ringbuffer_get_bit_at_pos(stream, stream->sync_next_offset-stream->sample_offset);
+		stream->sync_next_offset++;
+	}
+	
+	return __builtin_popcountll((stream->sync_shiftregs[(stream->sample_offset+pos_last_bit)%samples_per_bit]^sync_word)&sync_mask)<=sync_tolerance;
+}
+
+void read_bytes(stream_t * const stream, const uint32_t startpos_samples, const uint8_t nb, uint8_t * const dst)
 {
 	uint8_t i;
 	for(i=0; i<nb; i++)
-		dst[i]=get_byte(startpos_samples+BYTES_TO_SAMPLES(i));
+		dst[i]=get_byte(stream, startpos_samples+BYTES_TO_SAMPLES(i));
 }
 
 uint8_t calc_crc8(uint8_t const * const data, const uint16_t sz_bits)
@@ -277,13 +543,13 @@ uint16_t calc_crc16(uint8_t const * const data, const uint16_t sz_bits)
 	return crc;
 }
 
-void read_pcf(uint32_t startpos_samples, nRF24_packet_t * const packet) //packet control field
+void read_pcf(stream_t * const stream, uint32_t startpos_samples, nRF24_packet_t * const packet) //packet control field
 {
-	packet->pcf.payload_length=get_bits(startpos_samples, 6);
+	packet->pcf.payload_length=get_bits(stream, startpos_samples, 6);
 	startpos_samples+=BITS_TO_SAMPLES(6);
-	packet->pcf.pid=get_bits(startpos_samples, 2);
+	packet->pcf.pid=get_bits(stream, startpos_samples, 2);
 	startpos_samples+=BITS_TO_SAMPLES(2);
-	packet->pcf.no_ack=!!get_bits(startpos_samples, 1);
+	packet->pcf.no_ack=!!get_bits(stream, startpos_samples, 1);
 	startpos_samples+=BITS_TO_SAMPLES(1);
 }
 
@@ -329,11 +595,29 @@ uint16_t pack_for_crc(uint8_t * const buf, nRF24_packet_t const * const packet,
 	return bits_total;
 }
 
-void disp_packet_verbose(nRF24_packet_t const * const packet, struct timeval const * const timestamp, const packettype_t packettype, const bool is_retransmit)
+void disp_packet_verbose(pending_packet_t const * const pending, const bool is_retransmit)
 {
+	nRF24_packet_t const * const packet=&pending->packet;
+	const packettype_t packettype=pending->packettype;
+	
 	uint8_t i;
+	bool first;
+	
+	fprintf(stderr, "[%10lu.%06lu] ", pending->timestamp.tv_sec, pending->timestamp.tv_usec);
 	
-	fprintf(stderr, "[%10lu.%06lu] ", timestamp->tv_sec, timestamp->tv_usec);
+	if(nb_streams>1)
+	{
+		fprintf(stderr, "[rx=");
+		for(i=0, first=true; i<nb_streams; i++)
+		{
+			if(pending->receivers&(1<<i))
+			{
+				fprintf(stderr, first?"%u":",%u", i);
+				first=false;
+			}
+		}
+		fprintf(stderr, "] ");
+	}
 	
 	if(is_retransmit)
 		fprintf(stderr, "[RETRANSMIT] ");
@@ -365,6 +649,18 @@ void disp_packet_verbose(nRF24_packet_t const * const packet, struct timeval con
 	else
 		fprintf(stderr, "CRC=%04x (ok)", packet->crc.crc16);
 	
+	if(sampleformat==SAMPLE_FLOAT)
+		fprintf(stderr, " weakest-bit=%.2f", pending->weakest_bit);
+	
+	if(sampleformat==SAMPLE_BIT_MAG)
+	{
+		fprintf(stderr, " RSSI=%.1fdBFS", pending->rssi);
+		if(isnan(pending->snr))
+			fprintf(stderr, " SNR=n/a");
+		else
+			fprintf(stderr, " SNR=%.1fdB", pending->snr);
+	}
+	
 	fprintf(stderr, "\n");
 }
 
@@ -383,22 +679,22 @@ void update_summary(const bool show_retransmits, const bool is_retransmit) //add
 		fprintf(stderr, "nRF24 %lu packets\r", nb_valid_packets);
 }
 
-bool make_packet_from_samples(uint32_t startpos_samples, nRF24_packet_t * const packet, payloadlengthmode_t mode, const uint8_t sz_payload, uint16_t * const packetsize_samples)
+bool make_packet_from_samples(stream_t * const stream, uint32_t startpos_samples, nRF24_packet_t * const packet, payloadlengthmode_t mode, const uint8_t sz_payload, uint16_t * const packetsize_samples)
 {
-	read_bytes(startpos_samples, sz_addr_bytes, packet->addr);
+	read_bytes(stream, startpos_samples, sz_addr_bytes, packet->addr);
 	startpos_samples+=BYTES_TO_SAMPLES(sz_addr_bytes);
 	uint32_t sz_samples=BYTES_TO_SAMPLES(sz_addr_bytes);
 	
 	if(nrfmode==MODE_NORMAL)
 	{
-		read_pcf(startpos_samples, packet);
+		read_pcf(stream, startpos_samples, packet);
 		startpos_samples+=BITS_TO_SAMPLES(BITS_PCF);	
 		sz_samples+=BITS_TO_SAMPLES(BITS_PCF);	
 	}
 	
 	if(mode==PAYLOAD_FIXED_LENGTH)
 	{		
-		read_bytes(startpos_samples, sz_payload, packet->payload);
+		read_bytes(stream, startpos_samples, sz_payload, packet->payload);
 		packet->sz_payload_bytes=sz_payload;
 		startpos_samples+=BYTES_TO_SAMPLES(sz_payload);
 		sz_samples+=BYTES_TO_SAMPLES(sz_payload);
@@ -408,7 +704,7 @@ bool make_packet_from_samples(uint32_t startpos_samples, nRF24_packet_t * const
 		if(packet->pcf.payload_length>32)
 			return false; //this can't be a valid packet
 		
-		read_bytes(startpos_samples, packet->pcf.payload_length, packet->payload);
+		read_bytes(stream, startpos_samples, packet->pcf.payload_length, packet->payload);
 		packet->sz_payload_bytes=packet->pcf.payload_length;
 		startpos_samples+=BYTES_TO_SAMPLES(packet->pcf.payload_length);
 		sz_samples+=BYTES_TO_SAMPLES(packet->pcf.payload_length);
@@ -416,13 +712,13 @@ bool make_packet_from_samples(uint32_t startpos_samples, nRF24_packet_t * const
 	
 	if(crcmode==CRC_ONE_BYTE)
 	{
-		packet->crc.crc8=get_byte(startpos_samples);
+		packet->crc.crc8=get_byte(stream, startpos_samples);
 		startpos_samples+=BYTES_TO_SAMPLES(1);
 		sz_samples+=BYTES_TO_SAMPLES(1);
 	}
 	else
 	{
-		packet->crc.crc16=((uint16_t)get_byte(startpos_samples))<<8|get_byte(startpos_samples+BYTES_TO_SAMPLES(1));
+		packet->crc.crc16=((uint16_t)get_byte(stream, startpos_samples))<<8|get_byte(stream, startpos_samples+BYTES_TO_SAMPLES(1));
 		startpos_samples+=BYTES_TO_SAMPLES(2);
 		sz_samples+=BYTES_TO_SAMPLES(2);
 	}
@@ -432,203 +728,1073 @@ bool make_packet_from_samples(uint32_t startpos_samples, nRF24_packet_t * const
 	return true;
 }
 
-bool check_display_packet(uint16_t * const packetsize_samples)
+float magnitude_to_dbfs(const float mag)
 {
-	nRF24_packet_t packet;
-	
-	uint32_t startpos_samples=BITS_TO_SAMPLES(BITS_PREAMBLE);
-	
-	uint8_t buf[BUF_CRC_MAX];
-	static uint8_t buf_previous[BUF_CRC_MAX];
+	if(mag<0.5) //below one quantization step, avoid -inf
+		return 20*log10f(0.5/MAG_FULL_SCALE);
+	return 20*log10f(mag/MAG_FULL_SCALE);
+}
 
-	uint16_t bits_total;
-	static uint16_t bits_total_previous=0;
-	
-	bool is_retransmit;
-	
-	struct timeval tv;
+void update_noise_floor(stream_t * const stream) //called for samples at ring buffer position 0 that are not part of a decoded packet
+{
+	const uint32_t mag=ringbuffer_get_magnitude_at_pos(stream, 0);
 	
+	if(stream->noise_acc==0)
+		stream->noise_acc=(mag<<NOISE_FLOOR_SHIFT)|1; //|1 so it is never 0 again
+	else if((mag<<NOISE_FLOOR_SHIFT)>NOISE_FLOOR_GATE*stream->noise_acc+(1<<NOISE_FLOOR_SHIFT)) //+1 so a floor near 0 can still grow
+		return;
+	else
+		stream->noise_acc=stream->noise_acc-(stream->noise_acc>>NOISE_FLOOR_SHIFT)+mag;
+}
+
+//The preamble has as many 0 as 1 so the average of its bits is the DC offset caused by the frequency offset of the transmitter. Every preamble candidate is measured on its own, so detection does not depend on the offset of the previous transmitter or on the noise in between.
+void lock_dc_offset_on_preamble(stream_t * const stream, const uint32_t startpos)
+{
+	float bits[BITS_PREAMBLE];
+	float sum=0;
+	float sum_abs=0;
 	uint8_t i;
 	
-	if(payloadlengthmode==PAYLOAD_DYNAMIC_LENGTH || sz_payload_bytes==sz_ack_payload_bytes) //there is no way to distinguish between data-packets and ack-packets with payload
-	{
-		if(payloadlengthmode==PAYLOAD_DYNAMIC_LENGTH)
-		{
-			if(!make_packet_from_samples(startpos_samples, &packet, PAYLOAD_DYNAMIC_LENGTH, 0, packetsize_samples))
-				return false; //invalid packet
-			bits_total=pack_for_crc(buf, &packet, packet.pcf.payload_length);
-		}
-		else
-		{
-			make_packet_from_samples(startpos_samples, &packet, PAYLOAD_FIXED_LENGTH, sz_payload_bytes, packetsize_samples); //or sz_payload_ack_bytes, they have the same value
-			bits_total=pack_for_crc(buf, &packet, sz_payload_bytes); //or sz_payload_ack_bytes, they have the same value
-		}
-		if((crcmode==CRC_ONE_BYTE && calc_crc8(buf, bits_total)==packet.crc.crc8) || calc_crc16(buf, bits_total)==packet.crc.crc16)
-		{
-			if(filtermode==FILTER_BY_ADDRESS && memcmp(packet.addr, filter_by_address, sz_addr_bytes))
-				return true; //valid packet but nothing to be displayed because the address does not match
-			
-			if(dispmode==DISP_VERBOSE)
-			{
-				gettimeofday(&tv, NULL);
-				disp_packet_verbose(&packet, &tv, PACKET_UNDISTINGUISHABLE, false);
-			}
-			else if(dispmode==DISP_SUMMARY)
-				update_summary(false, false);
-			
-			if(dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD)
-				for(i=0; i<packet.sz_payload_bytes; i++)
-					putc(packet.payload[i], stdout);
-			
-			
-			return true;
-		}
-		else //no valid packet, CRC does not match
-			return false;
-	}
-	else //we have a way to distinguish between data-packets and ack-packets with or without payload using CRC
+	for(i=0; i<BITS_PREAMBLE; i++)
 	{
-		packettype_t packettype=PACKET_INVALID;
-		
-		//is data-packet?
-		make_packet_from_samples(startpos_samples, &packet, PAYLOAD_FIXED_LENGTH, sz_payload_bytes, packetsize_samples);
-		bits_total=pack_for_crc(buf, &packet, packet.sz_payload_bytes);
-		if((crcmode==CRC_ONE_BYTE && calc_crc8(buf, bits_total)==packet.crc.crc8) || calc_crc16(buf, bits_total)==packet.crc.crc16)
-			packettype=PACKET_DATA_PACKET;
-		else //is ack-packet?
-		{
-			make_packet_from_samples(startpos_samples, &packet, PAYLOAD_FIXED_LENGTH, sz_ack_payload_bytes, packetsize_samples);
-			bits_total=pack_for_crc(buf, &packet, packet.sz_payload_bytes);
-			if((crcmode==CRC_ONE_BYTE && calc_crc8(buf, bits_total)==packet.crc.crc8) || calc_crc16(buf, bits_total)==packet.crc.crc16)
-				packettype=PACKET_ACK_PACKET;
-			else
-				return false; //invalid packet, no CRC-match
-		}
-		
-		if(filtermode==FILTER_BY_ADDRESS && memcmp(packet.addr, filter_by_address, sz_addr_bytes))
-			return true; //valid packet but nothing to be displayed because the address does not match
-		
-		if(packettype==PACKET_DATA_PACKET)
-		{
-			if(nrfmode==MODE_NORMAL && bits_total==bits_total_previous && !memcmp(buf, buf_previous, (bits_total+4)/8))
-				is_retransmit=true;
-			else
-			{
-				is_retransmit=false;
-				bits_total_previous=bits_total;
-				memcpy(buf_previous, buf, (bits_total+4)/8);
-			}
-			
-			if(dispmode==DISP_VERBOSE || (dispmode==DISP_RETRANSMITS_ONLY && is_retransmit))
-			{
-				gettimeofday(&tv, NULL);
-				disp_packet_verbose(&packet, &tv, PACKET_DATA_PACKET, is_retransmit);
-			}
-			else if(dispmode==DISP_SUMMARY)
-				update_summary(true, is_retransmit);
-			
-			if(dumpmode==DUMP_PACKET_PAYLOAD || dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD)
-				for(i=0; i<packet.sz_payload_bytes; i++)
-					putc(packet.payload[i], stdout);
-		}
-		else //PACKET_ACK_PACKET
-		{
-			if(dispmode==DISP_VERBOSE)
-			{
-				gettimeofday(&tv, NULL);
-				disp_packet_verbose(&packet, &tv, PACKET_ACK_PACKET, false);
-			}
-			else if(dispmode==DISP_SUMMARY)
-				update_summary(true, false);
-			
-			if(dumpmode==DUMP_ACK_PAYLOAD || dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD)
-				for(i=0; i<packet.sz_payload_bytes; i++)
-					putc(packet.payload[i], stdout);
-		}
-		
-		return true;
+		bits[i]=ringbuffer_get_integrated_at_pos(stream, startpos+BITS_TO_SAMPLES(i));
+		sum+=bits[i];
 	}
+	stream->dc_offset=sum/BITS_PREAMBLE;
+	
+	for(i=0; i<BITS_PREAMBLE; i++)
+		sum_abs+=fabsf(bits[i]-stream->dc_offset);
+	stream->amplitude=sum_abs/BITS_PREAMBLE;
 }
 
-void print_usage_and_exit(void)
-{
-	fprintf(stderr, "usage: cat $pipe_or_file | ./nrf-decoder [options]\n");
-	fprintf(stderr, "options:\n\t--spb $samples_per_bit (mandatory)\n\t--sz-addr $sz_addr_bytes (mandatory)\n\t--sz-payload $sz_payload_bytes\n\t--sz-ack-payload $sz_ack_payload_bytes\n\t--dyn-lengths\n\t--disp [verbose|retransmits|none]\n\t--dump-payload [data|ack|all]\n\t--mode-compatibility\n\t--crc16\n\t--filter-addr $addr_in_hex\n");
-	exit(0);
-}
-
-void parse_dispmode(char const * const str)
+uint16_t copy_soft_bits(stream_t const * const stream, const uint16_t packetsize_samples, float * const dst) //relative to the amplitude of the preamble, returns the number of bits
 {
-	if(!strcmp(str, "verbose"))
-		dispmode=DISP_VERBOSE;
-	else if(!strcmp(str, "retransmits"))
-		dispmode=DISP_RETRANSMITS_ONLY;
-	else if(!strcmp(str, "none"))
-		dispmode=DISP_NONE;
-	else
-		errx(1, "invalid argument for --disp");
+	const uint16_t nb_bits=packetsize_samples/samples_per_bit;
+	uint16_t i;
+	
+	for(i=0; i<nb_bits; i++)
+		dst[i]=(stream->amplitude>0)?stream->soft_bits[BITS_PREAMBLE+i]/stream->amplitude:0;
+	
+	return nb_bits;
 }
 
-void parse_dumpmode(char const * const str)
+float find_weakest_bit(float const * const soft_bits, const uint16_t nb_soft_bits)
 {
-	if(!strcmp(str, "data"))
-		dumpmode=DUMP_PACKET_PAYLOAD;
-	else if(!strcmp(str, "ack"))
-		dumpmode=DUMP_ACK_PAYLOAD;
-	else if(!strcmp(str, "all"))
-		dumpmode=DUMP_PACKET_AND_ACK_PAYLOAD;
-	else
-		errx(1, "invalid argument for --dump-payload");
+	float weakest=INFINITY;
+	uint16_t i;
+	
+	for(i=0; i<nb_soft_bits; i++)
+		if(fabsf(soft_bits[i])<weakest)
+			weakest=fabsf(soft_bits[i]);
+	
+	return (nb_soft_bits>0)?weakest:0;
 }
 
-uint8_t parse_hex_byte(char const * const str)
+void measure_packet_signal(stream_t * const stream, const uint32_t nb_samples, float * const rssi, float * const snr)
 {
-	uint8_t ret;
+	uint32_t sum=0;
+	uint32_t i;
 	
-	if(isdigit(str[0]))
-		ret=(str[0]-'0')<<4;
-	else
-		ret=(tolower(str[0])-'a'+10)<<4;
+	for(i=0; i<nb_samples; i++)
+		sum+=ringbuffer_get_magnitude_at_pos(stream, i);
 	
-	if(isdigit(str[1]))
-		ret|=(str[1]-'0');
+	(*rssi)=magnitude_to_dbfs((float)sum/nb_samples);
+	
+	if(stream->noise_acc==0) //nothing measured yet, for instance with --index-query
+		(*snr)=NAN;
 	else
-		ret|=(tolower(str[1])-'a'+10);
+		(*snr)=(*rssi)-magnitude_to_dbfs((float)stream->noise_acc/(1<<NOISE_FLOOR_SHIFT));
 	
-	return ret;
+	stream->nb_packets++;
+	stream->sum_rssi+=(*rssi);
+	if(!isnan(*snr))
+	{
+		stream->sum_snr+=(*snr);
+		stream->nb_snr++;
+	}
 }
 
-void parse_filter_addr(char const * const str, uint8_t * const sz_parsed_addr)
+void update_addr_stats(pending_packet_t const * const pending)
 {
-	char const * ptr=str;
-	if(!memcmp(ptr,"0x",2))
-		ptr+=2;
+	addr_stats_t * stats=NULL;
+	uint8_t i;
 	
-	uint8_t len=strlen(ptr);
+	for(i=0; i<nb_addr_stats; i++)
+	{
+		if(!memcmp(addr_stats[i].addr, pending->packet.addr, sz_addr_bytes))
+		{
+			stats=&addr_stats[i];
+			break;
+		}
+	}
 	
-	if(len%2)
-		errx(1, "invalid argument for --filter-address: use always 2 hex-characters per byte");
+	if(!stats)
+	{
+		if(nb_addr_stats==NB_ADDR_STATS_MAX)
+			return; //table full, only count the first addresses
+		stats=&addr_stats[nb_addr_stats++];
+		memset(stats, 0, sizeof(addr_stats_t));
+		memcpy(stats->addr, pending->packet.addr, SZ_ADDR_BYTES_MAX);
+		stats->min_snr=NAN;
+	}
 	
+	stats->nb_packets++;
+	stats->sum_rssi+=pending->rssi;
+	if(!isnan(pending->snr))
+	{
+		stats->sum_snr+=pending->snr;
+		stats->nb_snr++;
+		if(isnan(stats->min_snr) || pending->snr<stats->min_snr)
+			stats->min_snr=pending->snr;
+	}
+}
+
+void print_signal_stats(void)
+{
 	uint8_t i,j;
 	
-	(*sz_parsed_addr)=0;
+	fprintf(stderr, "\nsignal per address:\n");
+	for(i=0; i<nb_addr_stats; i++)
+	{
+		fprintf(stderr, "addr=");
+		for(j=0; j<sz_addr_bytes; j++)
+			fprintf(stderr, "%02x ", addr_stats[i].addr[j]);
+		fprintf(stderr, "%lu packets, RSSI avg %.1fdBFS", addr_stats[i].nb_packets, addr_stats[i].sum_rssi/addr_stats[i].nb_packets);
+		if(addr_stats[i].nb_snr)
+			fprintf(stderr, ", SNR avg %.1fdB min %.1fdB\n", addr_stats[i].sum_snr/addr_stats[i].nb_snr, addr_stats[i].min_snr);
+		else
+			fprintf(stderr, ", SNR n/a\n");
+	}
 	
-	for(i=0,j=0; (i<len && j<5); i+=2,j++)
+	if(nb_streams>1)
 	{
-		if(!isxdigit(ptr[i]) || !isxdigit(ptr[i+1]))
-			errx(1, "invalid argument for --filter-address: invalid character found");
-		filter_by_address[j]=parse_hex_byte(&ptr[i]);
-		(*sz_parsed_addr)++;
+		fprintf(stderr, "signal per receiver:\n");
+		for(i=0; i<nb_streams; i++)
+		{
+			fprintf(stderr, "receiver %u (%s): %lu packets", i, streams[i].name, streams[i].nb_packets);
+			if(streams[i].nb_packets)
+				fprintf(stderr, ", RSSI avg %.1fdBFS", streams[i].sum_rssi/streams[i].nb_packets);
+			if(streams[i].nb_snr)
+				fprintf(stderr, ", SNR avg %.1fdB", streams[i].sum_snr/streams[i].nb_snr);
+			fprintf(stderr, "\n");
+		}
 	}
 }
 
-static volatile bool run=true;
-
-static void sigint(int sig)
+void emit_packet(pending_packet_t const * const pending)
 {
-	(void)sig;
-	run=false;
-}
+	nRF24_packet_t const * const packet=&pending->packet;
+
+	static uint8_t buf_previous[BUF_CRC_MAX];
+	static uint16_t bits_total_previous=0;
+
+	bool is_retransmit;
+
+	uint8_t i;
+
+	if(sampleformat==SAMPLE_BIT_MAG)
+		update_addr_stats(pending);
+
+	if(pending->packettype==PACKET_UNDISTINGUISHABLE)
+	{
+		if(dispmode==DISP_VERBOSE)
+			disp_packet_verbose(pending, false);
+		else if(dispmode==DISP_SUMMARY)
+			update_summary(false, false);
+
+		if(dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD)
+			for(i=0; i<packet->sz_payload_bytes; i++)
+				putc(packet->payload[i], stdout);
+	}
+	else if(pending->packettype==PACKET_DATA_PACKET)
+	{
+		if(nrfmode==MODE_NORMAL && pending->bits_total==bits_total_previous && !memcmp(pending->buf, buf_previous, (pending->bits_total+4)/8))
+			is_retransmit=true;
+		else
+		{
+			is_retransmit=false;
+			bits_total_previous=pending->bits_total;
+			memcpy(buf_previous, pending->buf, (pending->bits_total+4)/8);
+		}
+
+		if(dispmode==DISP_VERBOSE || (dispmode==DISP_RETRANSMITS_ONLY && is_retransmit))
+			disp_packet_verbose(pending, is_retransmit);
+		else if(dispmode==DISP_SUMMARY)
+			update_summary(true, is_retransmit);
+
+		if(dumpmode==DUMP_PACKET_PAYLOAD || dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD)
+			for(i=0; i<packet->sz_payload_bytes; i++)
+				putc(packet->payload[i], stdout);
+	}
+	else //PACKET_ACK_PACKET
+	{
+		if(dispmode==DISP_VERBOSE)
+			disp_packet_verbose(pending, false);
+		else if(dispmode==DISP_SUMMARY)
+			update_summary(true, false);
+
+		if(dumpmode==DUMP_ACK_PAYLOAD || dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD)
+			for(i=0; i<packet->sz_payload_bytes; i++)
+				putc(packet->payload[i], stdout);
+	}
+}
+
+int64_t timeval_diff_us(struct timeval const * const a, struct timeval const * const b) //a-b
+{
+	return ((int64_t)a->tv_sec-b->tv_sec)*1000000+((int64_t)a->tv_usec-b->tv_usec);
+}
+
+bool is_same_packet(nRF24_packet_t const * const a, nRF24_packet_t const * const b) //key for deduplication is address, PID and CRC
+{
+	if(memcmp(a->addr, b->addr, sz_addr_bytes) || a->pcf.pid!=b->pcf.pid)
+		return false;
+
+	if(crcmode==CRC_ONE_BYTE)
+		return a->crc.crc8==b->crc.crc8;
+	else
+		return a->crc.crc16==b->crc.crc16;
+}
+
+int64_t get_receiver_offset_us(receiver_offset_t const * const ro) //median of the last 3, needs nb_offsets>=3
+{
+	const int64_t a=ro->offsets_us[0];
+	const int64_t b=ro->offsets_us[1];
+	const int64_t c=ro->offsets_us[2];
+	
+	return (a<b)?((b<c)?b:((a<c)?c:a)):((a<c)?a:((b<c)?c:b));
+}
+
+void get_stream_time(stream_t const * const stream, struct timeval * const tv) //time of ring buffer position 0, that is of the packet being decoded
+{
+	int64_t time_base_us=stream->time_base_us;
+	int64_t us;
+	uint8_t i;
+	
+	if(indexmode==INDEX_QUERY) //wall clock is meaningless here, use time since start of capture
+	{
+		tv->tv_sec=stream->sample_offset/samplerate;
+		tv->tv_usec=(stream->sample_offset%samplerate)*1000000/samplerate;
+	}
+	else if(samplerate) //time of the first sample of the packet, not of the decoding which depends on how the input is split into chunks
+	{
+		for(i=0; i<stream->index; i++) //a receiver that shares packets with another one uses its time base, so both give the same time for the same packet whatever the latency of each
+		{
+			if(receiver_offsets[i][stream->index].nb_offsets>=3)
+			{
+				time_base_us=streams[i].time_base_us-get_receiver_offset_us(&receiver_offsets[i][stream->index]);
+				break;
+			}
+		}
+		us=time_base_us+(int64_t)(stream->sample_offset*1000000/samplerate);
+		tv->tv_sec=us/1000000;
+		tv->tv_usec=us%1000000;
+	}
+	else
+		gettimeofday(tv, NULL);
+}
+
+int64_t get_sample_clock_us(stream_t const * const stream) //exact time since the start of this input, but every receiver has its own
+{
+	return stream->sample_offset*1000000/samplerate;
+}
+
+void learn_receiver_offset(const uint8_t rx_a, const int64_t sample_clock_a_us, const uint8_t rx_b, const int64_t sample_clock_b_us) //both receivers heard the same packet
+{
+	receiver_offset_t * const ro=&receiver_offsets[(rx_a<rx_b)?rx_a:rx_b][(rx_a<rx_b)?rx_b:rx_a];
+	
+	ro->offsets_us[ro->nb_offsets%3]=(rx_a<rx_b)?sample_clock_b_us-sample_clock_a_us:sample_clock_a_us-sample_clock_b_us;
+	ro->nb_offsets++;
+	ro->last_sample_clock_us=(rx_a<rx_b)?sample_clock_a_us:sample_clock_b_us;
+	ro->nb_misses=0;
+}
+
+//Copies of one transmission come at the same time on all receivers, a retransmission at least a packet length and the shortest auto retransmit delay (250us) later. The wall clock timestamps are only as good as the way the receivers write their samples (several ms), so they are compared with --dedup-window only. Once two receivers heard a packet together the offset between their sample clocks is known to a few us and tells a copy from a retransmission, even if each receiver heard only one of them.
+bool is_copy(pending_packet_t const * const pending, stream_t const * const stream, struct timeval const * const tv, const int64_t sample_clock_us, const int64_t packet_us)
+{
+	receiver_offset_t * ro;
+	const uint8_t rx_a=pending->first_receiver;
+	const uint8_t rx_b=stream->index;
+	int64_t offset_us;
+	int64_t sample_clock_low_us;
+	int64_t tolerance_us;
+	
+	if(llabs(timeval_diff_us(tv, &pending->timestamp))>1000*(int64_t)dedup_window_ms)
+		return false;
+	
+	ro=&receiver_offsets[(rx_a<rx_b)?rx_a:rx_b][(rx_a<rx_b)?rx_b:rx_a];
+	if(ro->nb_offsets<3) //not known yet, the window has to do
+		return true;
+	
+	offset_us=get_receiver_offset_us(ro);
+	
+	sample_clock_low_us=(rx_a<rx_b)?pending->sample_clock_us:pending->sample_clock_us-offset_us;
+	tolerance_us=packet_us/2+llabs(sample_clock_low_us-ro->last_sample_clock_us)*SAMPLE_CLOCK_DRIFT_PPM/1000000;
+	if(tolerance_us>1000*(int64_t)dedup_window_ms)
+		tolerance_us=1000*(int64_t)dedup_window_ms;
+	
+	if(rx_a>rx_b)
+		offset_us=-offset_us;
+	
+	if(llabs(sample_clock_us-pending->sample_clock_us-offset_us)<=tolerance_us)
+		return true;
+	
+	if(++ro->nb_misses>=RECEIVER_OFFSET_MISSES_MAX)
+	{
+		ro->nb_offsets=0;
+		ro->nb_misses=0;
+	}
+	
+	return false;
+}
+
+bool all_inputs_past(struct timeval const * const tv) //no input can deliver a copy of a packet at tv anymore
+{
+	struct timeval stream_time;
+	uint8_t i;
+
+	for(i=0; i<nb_streams; i++)
+	{
+		if(streams[i].eof)
+			continue;
+		get_stream_time(&streams[i], &stream_time);
+		if(timeval_diff_us(&stream_time, tv)<=1000*(int64_t)dedup_window_ms)
+			return false;
+	}
+
+	return true;
+}
+
+void flush_pending_packets(const bool flush_all)
+{
+	while(nb_pending && (flush_all || all_inputs_past(&pending_packets[pending_first].timestamp)))
+	{
+		emit_packet(&pending_packets[pending_first]);
+		pending_first=(pending_first+1)%SZ_PENDING_QUEUE;
+		nb_pending--;
+	}
+}
+
+void output_packet(stream_t * const stream, nRF24_packet_t const * const packet, const packettype_t packettype, uint8_t const * const buf, const uint16_t bits_total, const uint16_t packetsize_samples)
+{
+	pending_packet_t * pending;
+	uint8_t i;
+
+	struct timeval tv;
+	int64_t sample_clock_us=0;
+	int64_t packet_us=0;
+
+	float rssi=0;
+	float snr=NAN;
+	float soft_bits[MAX_PACKET_LENGTH_BITS];
+	uint16_t nb_soft_bits=0;
+	float weakest_bit=0;
+
+	if(sampleformat==SAMPLE_BIT_MAG)
+		measure_packet_signal(stream, BITS_TO_SAMPLES(BITS_PREAMBLE)+packetsize_samples, &rssi, &snr);
+	else if(sampleformat==SAMPLE_FLOAT)
+	{
+		nb_soft_bits=copy_soft_bits(stream, packetsize_samples, soft_bits);
+		weakest_bit=find_weakest_bit(soft_bits, nb_soft_bits);
+	}
+
+	get_stream_time(stream, &tv);
+	if(samplerate)
+	{
+		sample_clock_us=get_sample_clock_us(stream);
+		packet_us=(int64_t)(BITS_TO_SAMPLES(BITS_PREAMBLE)+packetsize_samples)*1000000/samplerate;
+	}
+
+	//a receiver that already heard this packet is seeing a retransmit, not a copy
+	for(i=0; i<nb_pending; i++)
+	{
+		pending=&pending_packets[(pending_first+i)%SZ_PENDING_QUEUE];
+		if(!(pending->receivers&(1<<stream->index)) && is_same_packet(&pending->packet, packet) && is_copy(pending, stream, &tv, sample_clock_us, packet_us))
+		{
+			learn_receiver_offset(pending->first_receiver, pending->sample_clock_us, stream->index, sample_clock_us);
+			pending->receivers|=(1<<stream->index);
+			if(rssi>pending->rssi) //keep signal of the best receiver
+			{
+				pending->rssi=rssi;
+				pending->snr=snr;
+			}
+			if(weakest_bit>pending->weakest_bit)
+			{
+				memcpy(pending->soft_bits, soft_bits, nb_soft_bits*sizeof(float));
+				pending->nb_soft_bits=nb_soft_bits;
+				pending->weakest_bit=weakest_bit;
+			}
+			return;
+		}
+	}
+
+	if(nb_pending==SZ_PENDING_QUEUE) //should not happen with a sane window, make room by displaying the oldest packet early
+	{
+		emit_packet(&pending_packets[pending_first]);
+		pending_first=(pending_first+1)%SZ_PENDING_QUEUE;
+		nb_pending--;
+	}
+
+	//keep the queue sorted by timestamp, the inputs are decoded one chunk after the other
+	for(i=nb_pending; i>0 && timeval_diff_us(&pending_packets[(pending_first+i-1)%SZ_PENDING_QUEUE].timestamp, &tv)>0; i--)
+		pending_packets[(pending_first+i)%SZ_PENDING_QUEUE]=pending_packets[(pending_first+i-1)%SZ_PENDING_QUEUE];
+	pending=&pending_packets[(pending_first+i)%SZ_PENDING_QUEUE];
+	nb_pending++;
+
+	memcpy(&pending->packet, packet, sizeof(nRF24_packet_t));
+	pending->packettype=packettype;
+	memcpy(pending->buf, buf, BUF_CRC_MAX);
+	pending->bits_total=bits_total;
+	pending->timestamp=tv;
+	pending->sample_clock_us=sample_clock_us;
+	pending->first_receiver=stream->index;
+	pending->receivers=(1<<stream->index);
+	pending->rssi=rssi;
+	pending->snr=snr;
+	memcpy(pending->soft_bits, soft_bits, nb_soft_bits*sizeof(float));
+	pending->nb_soft_bits=nb_soft_bits;
+	pending->weakest_bit=weakest_bit;
+
+	if(nb_streams==1) //nothing to merge, display right away
+		flush_pending_packets(true);
+}
+
+void index_write_header(void)
+{
+	index_header_t header;
+	
+	memset(&header, 0, sizeof(index_header_t));
+	memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.samplerate=samplerate;
+	header.samples_per_bit=samples_per_bit;
+	header.sz_addr_bytes=sz_addr_bytes;
+	header.sampleformat=sampleformat;
+	header.nb_records=nb_index_records;
+	
+	if(fseek(index_file, 0, SEEK_SET) || fwrite(&header, sizeof(index_header_t), 1, index_file)!=1)
+		err(1, "writing header of index %s failed", index_filename);
+}
+
+void index_open(void)
+{
+	index_file=fopen(index_filename, "w");
+	if(!index_file)
+		err(1, "could not open %s", index_filename);
+	
+	index_write_header(); //placeholder, rewritten with the correct number of records by index_close()
+}
+
+void index_close(void)
+{
+	index_write_header();
+	
+	if(fclose(index_file))
+		err(1, "writing index %s failed", index_filename);
+	
+	fprintf(stderr, "%lu packets written to index %s\n", nb_index_records, index_filename);
+}
+
+void index_add_record(stream_t * const stream, nRF24_packet_t const * const packet, const packettype_t packettype, const bool crc_ok)
+{
+	index_record_t record;
+	
+	if(indexmode!=INDEX_WRITE)
+		return;
+	
+	if(!crc_ok && (filtermode!=FILTER_BY_ADDRESS || memcmp(packet->addr, filter_by_address, sz_addr_bytes)))
+		return; //without a known address every bit of noise that looks like a preamble would end up here
+	
+	if(!crc_ok)
+	{
+		if(stream->sample_offset<stream->index_damaged_until)
+			return; //same damaged packet found again at the next sample, only the first one is recorded
+		stream->index_damaged_until=stream->sample_offset+BITS_TO_SAMPLES(BITS_PREAMBLE)+BYTES_TO_SAMPLES(sz_addr_bytes);
+	}
+	
+	record.sample_offset=stream->sample_offset;
+	memcpy(record.addr, packet->addr, SZ_ADDR_BYTES_MAX);
+	record.packettype=packettype;
+	record.sz_payload_bytes=crc_ok?packet->sz_payload_bytes:0;
+	record.flags=crc_ok?INDEX_FLAG_CRC_OK:0;
+	
+	if(fwrite(&record, sizeof(index_record_t), 1, index_file)!=1)
+		err(1, "writing index %s failed", index_filename);
+	
+	nb_index_records++;
+}
+
+bool check_display_packet(stream_t * const stream, uint16_t * const packetsize_samples)
+{
+	nRF24_packet_t packet;
+
+	uint32_t startpos_samples=BITS_TO_SAMPLES(BITS_PREAMBLE);
+
+	uint8_t buf[BUF_CRC_MAX];
+
+	uint16_t bits_total;
+
+	if(payloadlengthmode==PAYLOAD_DYNAMIC_LENGTH || sz_payload_bytes==sz_ack_payload_bytes) //there is no way to distinguish between data-packets and ack-packets with payload
+	{
+		if(payloadlengthmode==PAYLOAD_DYNAMIC_LENGTH)
+		{
+			if(!make_packet_from_samples(stream, startpos_samples, &packet, PAYLOAD_DYNAMIC_LENGTH, 0, packetsize_samples))
+			{
+				index_add_record(stream, &packet, PACKET_INVALID, false);
+				return false; //invalid packet
+			}
+			bits_total=pack_for_crc(buf, &packet, packet.pcf.payload_length);
+		}
+		else
+		{
+			make_packet_from_samples(stream, startpos_samples, &packet, PAYLOAD_FIXED_LENGTH, sz_payload_bytes, packetsize_samples); //or sz_payload_ack_bytes, they have the same value
+			bits_total=pack_for_crc(buf, &packet, sz_payload_bytes); //or sz_payload_ack_bytes, they have the same value
+		}
+		if((crcmode==CRC_ONE_BYTE && calc_crc8(buf, bits_total)==packet.crc.crc8) || calc_crc16(buf, bits_total)==packet.crc.crc16)
+		{
+			index_add_record(stream, &packet, PACKET_UNDISTINGUISHABLE, true);
+			
+			if(filtermode==FILTER_BY_ADDRESS && memcmp(packet.addr, filter_by_address, sz_addr_bytes))
+				return true; //valid packet but nothing to be displayed because the address does not match
+
+			output_packet(stream, &packet, PACKET_UNDISTINGUISHABLE, buf, bits_total, *packetsize_samples);
+
+			return true;
+		}
+		else //no valid packet, CRC does not match
+		{
+			index_add_record(stream, &packet, PACKET_INVALID, false);
+			return false;
+		}
+	}
+	else //we have a way to distinguish between data-packets and ack-packets with or without payload using CRC
+	{
+		packettype_t packettype=PACKET_INVALID;
+
+		//is data-packet?
+		make_packet_from_samples(stream, startpos_samples, &packet, PAYLOAD_FIXED_LENGTH, sz_payload_bytes, packetsize_samples);
+		bits_total=pack_for_crc(buf, &packet, packet.sz_payload_bytes);
+		if((crcmode==CRC_ONE_BYTE && calc_crc8(buf, bits_total)==packet.crc.crc8) || calc_crc16(buf, bits_total)==packet.crc.crc16)
+			packettype=PACKET_DATA_PACKET;
+		else //is ack-packet?
+		{
+			make_packet_from_samples(stream, startpos_samples, &packet, PAYLOAD_FIXED_LENGTH, sz_ack_payload_bytes, packetsize_samples);
+			bits_total=pack_for_crc(buf, &packet, packet.sz_payload_bytes);
+			if((crcmode==CRC_ONE_BYTE && calc_crc8(buf, bits_total)==packet.crc.crc8) || calc_crc16(buf, bits_total)==packet.crc.crc16)
+				packettype=PACKET_ACK_PACKET;
+			else
+			{
+				index_add_record(stream, &packet, PACKET_INVALID, false);
+				return false; //invalid packet, no CRC-match
+			}
+		}
+
+		index_add_record(stream, &packet, packettype, true);
+
+		if(filtermode==FILTER_BY_ADDRESS && memcmp(packet.addr, filter_by_address, sz_addr_bytes))
+			return true; //valid packet but nothing to be displayed because the address does not match
+
+		output_packet(stream, &packet, packettype, buf, bits_total, *packetsize_samples);
+
+		return true;
+	}
+}
+
+//The preamble is found at the first sample where all its bits are right, which is about half a bit too early. Decoding starts at the sample phase with the strongest preamble instead, so every bit is integrated over its own samples only. If that fails the following positions are tried as they are, like for --sample-format bit, they integrate different samples and sometimes still get a damaged packet through.
+bool decode_packet_float(stream_t * const stream, uint16_t * const packetsize_samples)
+{
+	uint8_t phase;
+	uint8_t best_phase=0;
+	float best_amplitude=-1;
+	
+	if(indexmode==INDEX_QUERY) //the index holds the phase that decoded
+	{
+		lock_dc_offset_on_preamble(stream, 0);
+		return check_display_packet(stream, packetsize_samples);
+	}
+	
+	for(phase=0; phase<samples_per_bit; phase++)
+	{
+		lock_dc_offset_on_preamble(stream, phase);
+		if(stream->amplitude>best_amplitude)
+		{
+			best_amplitude=stream->amplitude;
+			best_phase=phase;
+		}
+	}
+	
+	if(stream->sample_offset+best_phase==stream->aligned_offset) //already tried
+		best_phase=0;
+	else
+		stream->aligned_offset=stream->sample_offset+best_phase;
+	
+	ringbuffer_remove_samples(stream, best_phase);
+	lock_dc_offset_on_preamble(stream, 0);
+	if(check_display_packet(stream, packetsize_samples))
+		return true;
+	
+	ringbuffer_rewind_samples(stream, best_phase);
+	return false;
+}
+
+bool decode_packet(stream_t * const stream, uint16_t * const packetsize_samples)
+{
+	if(sampleformat==SAMPLE_FLOAT)
+		return decode_packet_float(stream, packetsize_samples);
+	
+	return check_display_packet(stream, packetsize_samples);
+}
+
+void search_packet(stream_t * const stream) //called after each new sample
+{
+	uint16_t packetsize_samples;
+	bool found;
+
+	if(stream->nb_samples>=SEARCH_WINDOW_SAMPLES)
+	{
+		if(sampleformat==SAMPLE_FLOAT)
+			lock_dc_offset_on_preamble(stream, 0);
+		
+		found=false;
+		if(filtermode==FILTER_BY_ADDRESS)
+			found=check_for_sync_word(stream);
+		if(!found && (filtermode!=FILTER_BY_ADDRESS || indexmode==INDEX_WRITE)) //the index gets the packets of all addresses
+			found=check_for_preamble(stream);
+		
+		if(found && decode_packet(stream, &packetsize_samples))
+			ringbuffer_remove_samples(stream, BITS_TO_SAMPLES(BITS_PREAMBLE)+packetsize_samples); //so the end of the packet is not taken for noise
+		else
+		{
+			if(sampleformat==SAMPLE_BIT_MAG)
+				update_noise_floor(stream);
+			ringbuffer_remove_samples(stream, 1);
+		}
+	}
+}
+
+static volatile bool run=true;
+
+//A read() returns samples some time after they were received, how long depends on how the receiver writes them in chunks. The earliest estimate of the time of sample 0 is the best one, it is kept and only moved forward slowly to follow the drift between the clock of the receiver and the one of this computer.
+void update_time_base(stream_t * const stream, const uint64_t read_end_offset) //read_end_offset is the sample offset just after the chunk that was read
+{
+	struct timeval now;
+	int64_t time_base_us;
+	
+	gettimeofday(&now, NULL);
+	time_base_us=(int64_t)now.tv_sec*1000000+now.tv_usec-(int64_t)(read_end_offset*1000000/samplerate);
+	
+	if(stream->time_base_us==0 || time_base_us<stream->time_base_us)
+		stream->time_base_us=time_base_us;
+	else
+		stream->time_base_us+=TIME_BASE_DRIFT_US;
+}
+
+//Reading and decoding are separate so with several inputs all of them are read (and get their time, see update_time_base()) before the slow decoding of any of them.
+bool read_stream(stream_t * const stream) //returns false at end of stream
+{
+	ssize_t nb_read;
+
+	stream->sz_chunk=0;
+	memcpy(stream->chunk, stream->partial_sample, stream->nb_partial_bytes);
+	nb_read=read(stream->fd, stream->chunk+stream->nb_partial_bytes, SZ_READ_CHUNK-stream->nb_partial_bytes);
+
+	if(nb_read<0)
+	{
+		if(errno==EAGAIN || errno==EINTR)
+			return true;
+		err(1, "reading from %s failed", stream->name);
+	}
+
+	if(nb_read==0)
+		return false;
+
+	stream->sz_chunk=stream->nb_partial_bytes+nb_read;
+
+	if(samplerate)
+		update_time_base(stream, stream->sample_offset+stream->nb_samples+((sampleformat==SAMPLE_FLOAT)?stream->sz_chunk/sizeof(float):stream->sz_chunk));
+
+	return true;
+}
+
+void decode_chunk(stream_t * const stream)
+{
+	uint16_t i;
+	float sample;
+
+	if(!stream->sz_chunk) //nothing read (EAGAIN), partial_sample must stay as it is
+		return;
+
+	if(sampleformat==SAMPLE_FLOAT)
+	{
+		for(i=0; i+sizeof(float)<=stream->sz_chunk && run; i+=sizeof(float))
+		{
+			memcpy(&sample, &stream->chunk[i], sizeof(float));
+			ringbuffer_put_sample_float(stream, sample);
+			search_packet(stream);
+		}
+		if(!run) //stopped in the middle of the chunk, the rest is dropped anyway
+			stream->nb_partial_bytes=0;
+		else
+		{
+			if(stream->sz_chunk-i>=(int)sizeof(float))
+				errx(1, "decode_chunk: %u bytes left over, this is a bug", stream->sz_chunk-i);
+			stream->nb_partial_bytes=stream->sz_chunk-i;
+			memcpy(stream->partial_sample, &stream->chunk[i], stream->nb_partial_bytes);
+		}
+	}
+	else
+	{
+		for(i=0; i<stream->sz_chunk && run; i++)
+		{
+			ringbuffer_put_sample(stream, stream->chunk[i]);
+			search_packet(stream);
+		}
+	}
+	
+	stream->sz_chunk=0;
+}
+
+index_record_t const * index_find_first_record(index_record_t const * const records, const uint64_t nb_records, const uint64_t sample_offset) //records are sorted by sample offset
+{
+	uint64_t low=0;
+	uint64_t high=nb_records;
+	uint64_t mid;
+	
+	while(low<high)
+	{
+		mid=low+(high-low)/2;
+		if(records[mid].sample_offset<sample_offset)
+			low=mid+1;
+		else
+			high=mid;
+	}
+	
+	return &records[low];
+}
+
+void index_query(stream_t * const stream)
+{
+	int fd;
+	struct stat st;
+	uint8_t const * index_map;
+	uint8_t const * capture_map;
+	float const * capture_map_float;
+	uint64_t sz_capture;
+	
+	index_header_t const * header;
+	index_record_t const * records;
+	index_record_t const * record;
+	index_record_t const * records_end;
+	
+	uint64_t offset_from;
+	uint64_t offset_to;
+	uint64_t nb_matches=0;
+	
+	uint16_t packetsize_samples;
+	uint32_t i;
+	
+	fd=open(index_filename, O_RDONLY);
+	if(fd<0)
+		err(1, "could not open %s", index_filename);
+	if(fstat(fd, &st))
+		err(1, "fstat on %s failed", index_filename);
+	if((uint64_t)st.st_size<sizeof(index_header_t))
+		errx(1, "%s is not an index", index_filename);
+	index_map=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(index_map==MAP_FAILED)
+		err(1, "mmap of %s failed", index_filename);
+	close(fd);
+	
+	header=(index_header_t const *)index_map;
+	records=(index_record_t const *)(index_map+sizeof(index_header_t));
+	
+	if(memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) || (uint64_t)st.st_size!=sizeof(index_header_t)+header->nb_records*sizeof(index_record_t))
+		errx(1, "%s is not an index or is truncated", index_filename);
+	if(header->samples_per_bit!=samples_per_bit || header->sz_addr_bytes!=sz_addr_bytes)
+		errx(1, "index %s was made with --spb %u --sz-addr %u", index_filename, header->samples_per_bit, header->sz_addr_bytes);
+	if((header->sampleformat==SAMPLE_FLOAT)!=(sampleformat==SAMPLE_FLOAT))
+		errx(1, "index %s was made with a different --sample-format", index_filename);
+	
+	samplerate=header->samplerate;
+	
+	if(fstat(stream->fd, &st))
+		err(1, "fstat on %s failed", stream->name);
+	sz_capture=st.st_size;
+	capture_map=mmap(NULL, sz_capture, PROT_READ, MAP_PRIVATE, stream->fd, 0);
+	capture_map_float=(float const *)capture_map;
+	if(capture_map==MAP_FAILED)
+		err(1, "mmap of %s failed (--index-query needs a regular file as --input)", stream->name);
+	
+	offset_from=query_from*samplerate;
+	offset_to=(query_to<0)?UINT64_MAX:(uint64_t)(query_to*samplerate);
+	
+	records_end=records+header->nb_records;
+	
+	for(record=index_find_first_record(records, header->nb_records, offset_from); record<records_end && record->sample_offset<=offset_to && run; record++)
+	{
+		if(filtermode==FILTER_BY_ADDRESS && memcmp(record->addr, filter_by_address, sz_addr_bytes))
+			continue;
+		
+		nb_matches++;
+		
+		if(!(record->flags&INDEX_FLAG_CRC_OK)) //nothing to decode, just tell the user
+		{
+			if(dispmode==DISP_VERBOSE)
+			{
+				fprintf(stderr, "[%10lu.%06lu] damaged packet addr=", record->sample_offset/samplerate, (record->sample_offset%samplerate)*1000000/samplerate);
+				for(i=0; i<sz_addr_bytes; i++)
+					fprintf(stderr, "%02x ", record->addr[i]);
+				fprintf(stderr, "CRC=bad\n");
+			}
+			continue;
+		}
+		
+		if(record->sample_offset+SEARCH_WINDOW_SAMPLES>((sampleformat==SAMPLE_FLOAT)?sz_capture/sizeof(float):sz_capture))
+			errx(1, "index %s does not match capture %s", index_filename, stream->name);
+		
+		//load only the window of this packet into the ring buffer and decode it the usual way
+		stream->nb_samples=0;
+		stream->read_index=0;
+		stream->write_index=0;
+		stream->sample_offset=record->sample_offset;
+		for(i=0; i<SEARCH_WINDOW_SAMPLES; i++)
+		{
+			if(sampleformat==SAMPLE_FLOAT)
+				ringbuffer_put_sample_float(stream, capture_map_float[record->sample_offset+i]);
+			else
+				ringbuffer_put_sample(stream, capture_map[record->sample_offset+i]);
+		}
+		
+		if(!decode_packet(stream, &packetsize_samples))
+			warnx("packet at sample %lu did not decode, index does not match capture?", record->sample_offset);
+	}
+	
+	fprintf(stderr, "\n%lu matching packets in index\n", nb_matches);
+	
+	munmap((void *)capture_map, sz_capture);
+	munmap((void *)index_map, sizeof(index_header_t)+header->nb_records*sizeof(index_record_t));
+}
+
+void print_usage_and_exit(void)
+{
+	fprintf(stderr, "usage: cat $pipe_or_file | ./nrf-decoder [options]\n");
+	fprintf(stderr, "   or: ./nrf-decoder --input $fifo1 --input $fifo2 [...] [options]\n");
+	fprintf(stderr, "options:\n\t--spb $samples_per_bit (mandatory)\n\t--sz-addr $sz_addr_bytes (mandatory)\n\t--sz-payload $sz_payload_bytes\n\t--sz-ack-payload $sz_ack_payload_bytes\n\t--dyn-lengths\n\t--disp [verbose|retransmits|none]\n\t--dump-payload [data|ack|all]\n\t--mode-compatibility\n\t--crc16\n\t--filter-addr $addr_in_hex\n\t--sync-tolerance $bits\n\t--sample-format [bit|bit-mag|float]\n\t--input $fifo_or_file (can be repeated, \"-\" is stdin)\n\t--dedup-window $ms\n\t--index-write $index_file --samplerate $sps\n\t--index-query $index_file --input $capture_file [--from $seconds] [--to $seconds]\n");
+	exit(0);
+}
+
+void parse_dispmode(char const * const str)
+{
+	if(!strcmp(str, "verbose"))
+		dispmode=DISP_VERBOSE;
+	else if(!strcmp(str, "retransmits"))
+		dispmode=DISP_RETRANSMITS_ONLY;
+	else if(!strcmp(str, "none"))
+		dispmode=DISP_NONE;
+	else
+		errx(1, "invalid argument for --disp");
+}
+
+void parse_sampleformat(char const * const str)
+{
+	if(!strcmp(str, "bit"))
+		sampleformat=SAMPLE_BIT;
+	else if(!strcmp(str, "bit-mag"))
+		sampleformat=SAMPLE_BIT_MAG;
+	else if(!strcmp(str, "float"))
+		sampleformat=SAMPLE_FLOAT;
+	else
+		errx(1, "invalid argument for --sample-format");
+}
+
+void parse_dumpmode(char const * const str)
+{
+	if(!strcmp(str, "data"))
+		dumpmode=DUMP_PACKET_PAYLOAD;
+	else if(!strcmp(str, "ack"))
+		dumpmode=DUMP_ACK_PAYLOAD;
+	else if(!strcmp(str, "all"))
+		dumpmode=DUMP_PACKET_AND_ACK_PAYLOAD;
+	else
+		errx(1, "invalid argument for --dump-payload");
+}
+
+uint8_t parse_hex_byte(char const * const str)
+{
+	uint8_t ret;
+	
+	if(isdigit(str[0]))
+		ret=(str[0]-'0')<<4;
+	else
+		ret=(tolower(str[0])-'a'+10)<<4;
+	
+	if(isdigit(str[1]))
+		ret|=(str[1]-'0');
+	else
+		ret|=(tolower(str[1])-'a'+10);
+	
+	return ret;
+}
+
+void parse_filter_addr(char const * const str, uint8_t * const sz_parsed_addr)
+{
+	char const * ptr=str;
+	if(!memcmp(ptr,"0x",2))
+		ptr+=2;
+	
+	uint8_t len=strlen(ptr);
+	
+	if(len%2)
+		errx(1, "invalid argument for --filter-address: use always 2 hex-characters per byte");
+	
+	uint8_t i,j;
+	
+	(*sz_parsed_addr)=0;
+	
+	for(i=0,j=0; (i<len && j<5); i+=2,j++)
+	{
+		if(!isxdigit(ptr[i]) || !isxdigit(ptr[i+1]))
+			errx(1, "invalid argument for --filter-address: invalid character found");
+		filter_by_address[j]=parse_hex_byte(&ptr[i]);
+		(*sz_parsed_addr)++;
+	}
+}
+
+void add_input(char const * const name)
+{
+	if(nb_streams==NB_INPUTS_MAX)
+		errx(1, "too many --input, max %u", NB_INPUTS_MAX);
+	
+	streams[nb_streams].name=name;
+	streams[nb_streams].index=nb_streams;
+	streams[nb_streams].aligned_offset=UINT64_MAX;
+	nb_streams++;
+}
+
+static int stdin_flags; //restored by close_inputs(), the file description is shared with the shell
+
+void open_inputs(void)
+{
+	uint8_t i;
+	
+	for(i=0; i<nb_streams; i++)
+	{
+		if(!strcmp(streams[i].name, "-"))
+		{
+			streams[i].name="stdin";
+			streams[i].fd=STDIN_FILENO;
+			stdin_flags=fcntl(STDIN_FILENO, F_GETFL);
+			if(nb_streams>1 && (stdin_flags<0 || fcntl(STDIN_FILENO, F_SETFL, stdin_flags|O_NONBLOCK)))
+				err(1, "fcntl on stdin failed");
+		}
+		else
+		{
+			//O_NONBLOCK is needed for epoll and also avoids blocking on a FIFO until the receiver is started
+			streams[i].fd=open(streams[i].name, nb_streams>1?(O_RDONLY|O_NONBLOCK):O_RDONLY);
+			if(streams[i].fd<0)
+				err(1, "could not open %s", streams[i].name);
+		}
+		
+		if(sampleformat==SAMPLE_FLOAT)
+		{
+			streams[i].ringbuffer_float=malloc((SZ_BUFFER_SAMPLES+samples_per_bit)*sizeof(float));
+			streams[i].ringbuffer_integrated=malloc(SZ_BUFFER_SAMPLES*sizeof(float));
+			streams[i].soft_bits=malloc(MAX_PACKET_LENGTH_BITS*sizeof(float));
+			if(!streams[i].ringbuffer_float || !streams[i].ringbuffer_integrated || !streams[i].soft_bits)
+				err(1, "malloc for ring buffer failed");
+		}
+		else
+		{
+			streams[i].ringbuffer=malloc(SZ_BUFFER_SAMPLES);
+			if(!streams[i].ringbuffer)
+				err(1, "malloc for ring buffer failed");
+		}
+		
+		if(filtermode==FILTER_BY_ADDRESS && sampleformat!=SAMPLE_FLOAT)
+		{
+			streams[i].sync_shiftregs=calloc(samples_per_bit, sizeof(uint64_t));
+			if(!streams[i].sync_shiftregs)
+				err(1, "malloc for sync word correlator failed");
+		}
+		
+		if(nb_streams>1)
+			fprintf(stderr, "receiver %u: %s\n", i, streams[i].name);
+	}
+}
+
+void close_inputs(void)
+{
+	uint8_t i;
+	
+	for(i=0; i<nb_streams; i++)
+	{
+		if(streams[i].fd!=STDIN_FILENO)
+			close(streams[i].fd);
+		else if(nb_streams>1)
+			fcntl(STDIN_FILENO, F_SETFL, stdin_flags);
+		free(streams[i].ringbuffer);
+		free(streams[i].ringbuffer_float);
+		free(streams[i].ringbuffer_integrated);
+		free(streams[i].soft_bits);
+		free(streams[i].sync_shiftregs);
+	}
+}
+
+void decode_multiple_inputs(void)
+{
+	struct epoll_event events[NB_INPUTS_MAX];
+	struct epoll_event ev;
+	int epfd;
+	int nb_events;
+	int i;
+	uint8_t nb_open=nb_streams;
+	
+	epfd=epoll_create1(0);
+	if(epfd<0)
+		err(1, "epoll_create1 failed");
+	
+	for(i=0; i<nb_streams; i++)
+	{
+		ev.events=EPOLLIN;
+		ev.data.u32=i;
+		if(epoll_ctl(epfd, EPOLL_CTL_ADD, streams[i].fd, &ev))
+			err(1, "epoll_ctl for %s failed (multiple inputs must be pipes/FIFOs)", streams[i].name);
+	}
+	
+	while(nb_open && run)
+	{
+		nb_events=epoll_wait(epfd, events, NB_INPUTS_MAX, dedup_window_ms?dedup_window_ms:1);
+		if(nb_events<0)
+		{
+			if(errno==EINTR)
+				continue;
+			err(1, "epoll_wait failed");
+		}
+		
+		for(i=0; i<nb_events; i++)
+		{
+			if(!read_stream(&streams[events[i].data.u32]))
+			{
+				epoll_ctl(epfd, EPOLL_CTL_DEL, streams[events[i].data.u32].fd, NULL);
+				streams[events[i].data.u32].eof=true;
+				nb_open--;
+			}
+		}
+		
+		for(i=0; i<nb_events; i++)
+			decode_chunk(&streams[events[i].data.u32]);
+		
+		flush_pending_packets(false);
+	}
+	
+	flush_pending_packets(true);
+	
+	close(epfd);
+}
+
+static void sigint(int sig)
+{
+	(void)sig;
+	run=false;
+}
 
 int main(int argc, char **argv)
 {
@@ -644,6 +1810,15 @@ int main(int argc, char **argv)
 		{ "disp",				required_argument,	NULL,	7 },
 		{ "dump-payload",		required_argument,	NULL,	8 },
 		{ "filter-addr",		required_argument,	NULL,	9 },
+		{ "input",				required_argument,	NULL,	10 },
+		{ "dedup-window",		required_argument,	NULL,	11 },
+		{ "index-write",		required_argument,	NULL,	12 },
+		{ "samplerate",			required_argument,	NULL,	13 },
+		{ "index-query",		required_argument,	NULL,	14 },
+		{ "from",				required_argument,	NULL,	15 },
+		{ "to",					required_argument,	NULL,	16 },
+		{ "sync-tolerance",		required_argument,	NULL,	17 },
+		{ "sample-format",		required_argument,	NULL,	18 },
 		
 		{ "version",			no_argument,		NULL, 	100 },
 		{ "help",				no_argument,		NULL, 	101 },
@@ -677,6 +1852,15 @@ int main(int argc, char **argv)
 			case 7: parse_dispmode(optarg); break;
 			case 8: parse_dumpmode(optarg); break;
 			case 9: filtermode=FILTER_BY_ADDRESS; parse_filter_addr(optarg, &sz_parsed_addr); break;
+			case 10: add_input(optarg); break;
+			case 11: dedup_window_ms=atoi(optarg); break;
+			case 12: indexmode=INDEX_WRITE; index_filename=optarg; break;
+			case 13: samplerate=atoi(optarg); break;
+			case 14: indexmode=INDEX_QUERY; index_filename=optarg; break;
+			case 15: query_from=atof(optarg); break;
+			case 16: query_to=atof(optarg); break;
+			case 17: sync_tolerance=atoi(optarg); break;
+			case 18: parse_sampleformat(optarg); break;
 			
 			case 100: only_print_version=true; break;
 			case 101: print_usage_and_exit(); break;
@@ -709,6 +1893,12 @@ int main(int argc, char **argv)
 	if(filtermode==FILTER_BY_ADDRESS && sz_addr_bytes!=sz_parsed_addr)
 		errx(1, "size missmatch between specified address length and specified address for filtering");
 	
+	if(filtermode==FILTER_BY_ADDRESS)
+		make_sync_word();
+	
+	if(sync_tolerance>BITS_PREAMBLE)
+		errx(1, "--sync-tolerance must be <=%u", BITS_PREAMBLE);
+	
 	if((dumpmode==DUMP_PACKET_AND_ACK_PAYLOAD || dumpmode==DUMP_ACK_PAYLOAD) && nrfmode==MODE_COMPATIBILITY)
 		errx(1, "--dump-payload [ack|all] is incompatible with --mode-compatibility (ACK-packets can't have payload in this mode)");
 
@@ -718,36 +1908,49 @@ int main(int argc, char **argv)
 	if(dispmode==DISP_RETRANSMITS_ONLY && (payloadlengthmode==PAYLOAD_DYNAMIC_LENGTH || sz_payload_bytes==sz_ack_payload_bytes))
 		errx(1, "--disp retransmits will not work with --dyn-lengths or if --sz-payload equals --sz-ack-payload");
 
-	ringbuffer=malloc(SZ_BUFFER_SAMPLES);
-	if(!ringbuffer)
-		err(1, "malloc for ring buffer failed");
+	if(indexmode==INDEX_WRITE && samplerate==0)
+		errx(1, "--index-write needs --samplerate");
+	
+	if(nb_streams>1 && samplerate==0)
+		errx(1, "several --input need --samplerate");
+	
+	if(dedup_window_ms<0)
+		errx(1, "--dedup-window must be >=0");
+	
+	if(indexmode!=INDEX_OFF && nb_streams>1)
+		errx(1, "--index-write and --index-query only work with a single input");
+	
+	if(indexmode==INDEX_QUERY && nb_streams==0)
+		errx(1, "--index-query needs the capture as --input");
+	
+	if(nb_streams==0)
+		add_input("-");
+	
+	open_inputs();
 	
 	signal(SIGINT, &sigint);
 	
-	uint16_t packetsize_samples;
-
-	while(!feof(stdin) && run)
-	{
-		ringbuffer_put_sample(fgetc(stdin));
-		
-		if(nb_samples>=MAX_PACKET_LENGTH_SAMPLES)
-		{
-			if(check_for_preamble())
-			{
-				if(check_display_packet(&packetsize_samples))
-					ringbuffer_remove_samples(packetsize_samples);
-				else
-					ringbuffer_remove_samples(1);
-			}
-			else
-				ringbuffer_remove_samples(1);
-		}
-	}
+	if(indexmode==INDEX_WRITE)
+		index_open();
+	
+	if(indexmode==INDEX_QUERY)
+		index_query(&streams[0]);
+	else if(nb_streams==1)
+		while(run && read_stream(&streams[0]))
+			decode_chunk(&streams[0]);
+	else
+		decode_multiple_inputs();
 	
 	if(dispmode==DISP_SUMMARY) //to avoid summary being overwritten by shell
 		fprintf(stderr, "\n");
+	
+	if(indexmode==INDEX_WRITE)
+		index_close();
+	
+	if(sampleformat==SAMPLE_BIT_MAG)
+		print_signal_stats();
 
-	free(ringbuffer);
+	close_inputs();
 	
 	fprintf(stderr, "\nall done, bye\n");
 	